@@ -3,11 +3,20 @@
 #define FULLSCREEN			0
 #define WINDOW_LIMIT		8
 #define SCALE				2.0f
+#define DIRECT_RENDER		1 // skip the intermediate render texture when SCALE is a whole number
 #define FONT_SIZE			13.0f
 #define TILED_BACKGROUND	1
+#define STATS_SMOOTHING		0.05f
+#define STATS_DUMP_FILE		"taskmgr.txt"
+#define CAPTURE_PREFIX		"capture_" // press C to start/stop recording the screen
+#define CAPTURE_SLOTS		3 // frame copies on the GPU, and frames waiting for the encoder
+#define TEXTURE_BUDGET		(16 * 1024 * 1024) // bytes, caches are evicted to stay below it
+#define RESIZE_RELAYOUT_RATE	10 // content relayouts per second while resizing, 0 to relayout every frame
 
 // #define DEBUG_WINDRAWTEXT
 // #define DEBUG_MOVERESIZE
+// #define DEBUG_OVERDRAW
+// #define DEBUG_TEXMEM
 
 #define DEFAULT_THEME
 // #define YOUR_THEME
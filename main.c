@@ -1,18 +1,399 @@
 #include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "raylib.h"
+#include "rlgl.h"
+#include "raymath.h"
 #include "config.h"
 
 #define mcollide(x, y, w, h) \
-    CheckCollisionPointRec(GetMousePosition(), (Rectangle){x, y, w, h})
-
-#define lmbdown IsMouseButtonDown(MOUSE_LEFT_BUTTON)
-#define lmbup IsMouseButtonReleased(MOUSE_LEFT_BUTTON)
+    CheckCollisionPointRec(input.mouse, (Rectangle){x, y, w, h})
+
+#define mousex ((int)input.mouse.x)
+#define mousey ((int)input.mouse.y)
+#define lmbdown input.lmbDown
+#define lmbup input.lmbReleased
+#define lmbpressed input.lmbPressed
+#define keypressed(k) ((input.keys >> (k)) & 1)
 #define focused(i) (i >= WINDOW_LIMIT - 1)
 
 #define RENDER_WIDTH (SCREEN_WIDTH / SCALE)
 #define RENDER_HEIGHT (SCREEN_HEIGHT / SCALE)
 
+// adds to a counter of the window whose function is currently running, if any
+#define countStat(field, n) \
+    do { if (curStats) curStats->field += (n); } while (0)
+
+// _____________________________________________________________________________
+//
+//  Texture memory
+// _____________________________________________________________________________
+//
+
+// Every texture, render texture and vertex buffer is created through these
+// functions, which keep track of its size, format and owner. Caches that can be
+// regenerated are unloaded least recently used first when TEXTURE_BUDGET would
+// be exceeded. Required textures and buffers are always loaded, even over the
+// budget.
+
+#define TEXTURE_TRACK_LIMIT 64
+
+typedef struct TrackedTexture
+{
+    unsigned int id;
+    bool buffer; // a vertex buffer, whose ids are separate from texture ids
+    int width, height;
+    int format;
+    int bytes;
+    const char *owner;
+    RenderTexture *cache; // if set, the texture can be evicted, and this is zeroed when it is
+    double lastUsed;
+} TrackedTexture;
+
+TrackedTexture trackedTextures[TEXTURE_TRACK_LIMIT];
+int textureCount = 0;
+int textureMemory = 0; // bytes used by all tracked textures
+
+static void untrack(unsigned int id, bool buffer)
+{
+    for (int i = 0; i < textureCount; i++)
+    {
+        if (trackedTextures[i].id != id || trackedTextures[i].buffer != buffer) continue;
+
+        textureMemory -= trackedTextures[i].bytes;
+        trackedTextures[i] = trackedTextures[--textureCount];
+        return;
+    }
+}
+
+void untrackTexture(unsigned int id)
+{
+    untrack(id, false);
+}
+
+// Unloads least recently used caches until bytes more fit in the budget.
+// Returns false if they still don't fit.
+static bool makeTextureRoom(int bytes)
+{
+    while (textureMemory + bytes > TEXTURE_BUDGET)
+    {
+        TrackedTexture *lru = NULL;
+        for (int i = 0; i < textureCount; i++)
+        {
+            if (trackedTextures[i].cache && (!lru || trackedTextures[i].lastUsed < lru->lastUsed))
+                lru = &trackedTextures[i];
+        }
+        if (!lru) return false;
+
+        TraceLog(LOG_INFO, "TEXTURE: Evicting %s (%d bytes)", lru->owner, lru->bytes);
+        RenderTexture *cache = lru->cache;
+        untrackTexture(cache->texture.id);
+        UnloadRenderTexture(*cache);
+        *cache = (RenderTexture){0};
+    }
+    return true;
+}
+
+static void addTrackedTexture(TrackedTexture entry)
+{
+    if (textureCount == TEXTURE_TRACK_LIMIT)
+    {
+        TraceLog(LOG_WARNING, "TEXTURE: Too many textures to track, %s is not counted", entry.owner);
+        return;
+    }
+
+    entry.lastUsed = GetTime();
+    trackedTextures[textureCount++] = entry;
+    textureMemory += entry.bytes;
+}
+
+// Tracks an already loaded texture that is required by owner.
+Texture trackTexture(Texture texture, const char *owner)
+{
+    if (!texture.id) return texture;
+
+    int bytes = GetPixelDataSize(texture.width, texture.height, texture.format);
+    if (!makeTextureRoom(bytes))
+        TraceLog(LOG_WARNING, "TEXTURE: %s is over the budget", owner);
+
+    addTrackedTexture((TrackedTexture){
+        .id = texture.id,
+        .width = texture.width,
+        .height = texture.height,
+        .format = texture.format,
+        .bytes = bytes,
+        .owner = owner});
+    return texture;
+}
+
+Texture loadTrackedTexture(Image image, const char *owner)
+{
+    return trackTexture(LoadTextureFromImage(image), owner);
+}
+
+// Loads a render texture. If cache is not NULL, the render texture is stored
+// there, and it is unloaded when room is needed for other textures. A cache is
+// not loaded at all if it doesn't fit in the budget.
+RenderTexture loadTrackedRenderTexture(int width, int height, const char *owner, RenderTexture *cache)
+{
+    // color and depth buffers, both 32 bits per pixel
+    int bytes = width * height * 8;
+
+    if (!makeTextureRoom(bytes))
+    {
+        if (cache) return (RenderTexture){0};
+        TraceLog(LOG_WARNING, "TEXTURE: %s is over the budget", owner);
+    }
+
+    RenderTexture target = LoadRenderTexture(width, height);
+    if (!target.id) return target;
+
+    if (cache) *cache = target;
+
+    addTrackedTexture((TrackedTexture){
+        .id = target.texture.id,
+        .width = width,
+        .height = height,
+        .format = target.texture.format,
+        .bytes = bytes,
+        .owner = owner,
+        .cache = cache});
+    return target;
+}
+
+// Loads a vertex buffer that is required by owner.
+unsigned int loadTrackedVertexBuffer(const void *data, int size, bool dynamic, const char *owner)
+{
+    if (!makeTextureRoom(size))
+        TraceLog(LOG_WARNING, "TEXTURE: %s is over the budget", owner);
+
+    unsigned int id = rlLoadVertexBuffer(data, size, dynamic);
+    if (!id) return id;
+
+    addTrackedTexture((TrackedTexture){
+        .id = id,
+        .buffer = true,
+        .bytes = size,
+        .owner = owner});
+    return id;
+}
+
+// Returns the size of a tracked texture in bytes, 0 if it isn't tracked.
+int trackedBytes(unsigned int id)
+{
+    for (int i = 0; i < textureCount; i++)
+        if (trackedTextures[i].id == id && !trackedTextures[i].buffer) return trackedTextures[i].bytes;
+    return 0;
+}
+
+// Marks a texture as used this frame, so it is evicted later than others.
+void useTexture(unsigned int id)
+{
+    for (int i = 0; i < textureCount; i++)
+        if (trackedTextures[i].id == id && !trackedTextures[i].buffer) trackedTextures[i].lastUsed = GetTime();
+}
+
+void unloadTrackedTexture(Texture texture)
+{
+    untrackTexture(texture.id);
+    UnloadTexture(texture);
+}
+
+void unloadTrackedRenderTexture(RenderTexture target)
+{
+    untrackTexture(target.texture.id);
+    UnloadRenderTexture(target);
+}
+
+void unloadTrackedVertexBuffer(unsigned int id)
+{
+    untrack(id, true);
+    rlUnloadVertexBuffer(id);
+}
+
+#ifdef DEBUG_TEXMEM
+// Draws the total GPU memory and each tracked texture and buffer in the top right corner.
+void drawTextureMemory()
+{
+    int x = RENDER_WIDTH - 170;
+    DrawText(
+        TextFormat("GPU memory: %d KiB / %d KiB", textureMemory / 1024, TEXTURE_BUDGET / 1024),
+        x, 0, 10, textureMemory > TEXTURE_BUDGET ? RED : WHITE);
+
+    for (int i = 0; i < textureCount; i++)
+    {
+        TrackedTexture *t = &trackedTextures[i];
+        const char *text = t->buffer
+            ? TextFormat("%s buffer %d KiB", t->owner, t->bytes / 1024)
+            : TextFormat("%s%s %dx%d %d KiB", t->owner, t->cache ? "*" : "", t->width, t->height, t->bytes / 1024);
+        DrawText(text, x, 10 + i * 10, 10, WHITE);
+    }
+}
+#endif
+
+// _____________________________________________________________________________
+//
+//  Window statistics
+// _____________________________________________________________________________
+//
+
+// Cost accounting for a single window, shown in the task manager.
+// The first group is reset every time the window function is run.
+typedef struct WindowStats
+{
+    double time; // seconds spent in the window function
+    int draws;   // draw calls (rectangles, textures and glyphs) issued
+    int glyphs;  // glyphs drawn
+    int layout;  // codepoints processed by text layout
+
+    float avgTime, avgDraws, avgGlyphs, avgLayout; // rolling averages
+    float peakTime;
+    int peakDraws, peakGlyphs, peakLayout;
+} WindowStats;
+
+WindowStats *curStats = NULL; // stats of the window whose function is running
+
+// _____________________________________________________________________________
+//
+//  Overdraw debugging
+// _____________________________________________________________________________
+//
+
+// With DEBUG_OVERDRAW, every rectangle, sprite and glyph drawn to the desktop
+// is also counted per pixel on the CPU. The counts are shown as a heatmap on
+// top of the desktop, along with the pixels filled by each layer.
+
+typedef enum
+{
+    LAYER_WALLPAPER,
+    LAYER_SHADOW,
+    LAYER_BACKGROUND,
+    LAYER_CHROME,
+    LAYER_CONTENT,
+    LAYER_TASKBAR,
+    LAYER_COUNT
+} Layer;
+
+#ifdef DEBUG_OVERDRAW
+    #define overdrawRect(layer, x, y, w, h) countOverdraw(layer, x, y, w, h)
+    #define overdrawGlyph(layer, font, index, x, y) countGlyphOverdraw(layer, font, index, x, y)
+    #define overdrawText(layer, font, text, x, y) countTextOverdraw(layer, font, text, x, y)
+#else
+    #define overdrawRect(layer, x, y, w, h)
+    #define overdrawGlyph(layer, font, index, x, y)
+    #define overdrawText(layer, font, text, x, y)
+#endif
+
+typedef struct Overdraw
+{
+    bool counting;         // only draws to the desktop are counted, not to caches
+    unsigned char *counts; // writes per pixel this frame
+    Color *pixels;         // heatmap image
+    Texture texture;
+    long layerPixels[LAYER_COUNT];
+} Overdraw;
+
+Overdraw overdraw = {0};
+
+void countOverdraw(Layer layer, int x, int y, int width, int height)
+{
+    if (!overdraw.counting) return;
+
+    int x1 = x < 0 ? 0 : x;
+    int y1 = y < 0 ? 0 : y;
+    int x2 = x + width > RENDER_WIDTH ? RENDER_WIDTH : x + width;
+    int y2 = y + height > RENDER_HEIGHT ? RENDER_HEIGHT : y + height;
+    if (x2 <= x1 || y2 <= y1) return;
+
+    for (int py = y1; py < y2; py++)
+    {
+        unsigned char *row = &overdraw.counts[py * (int)RENDER_WIDTH];
+        for (int px = x1; px < x2; px++)
+            if (row[px] < 255) row[px]++;
+    }
+
+    overdraw.layerPixels[layer] += (long)(x2 - x1) * (y2 - y1);
+}
+
+// Counts the quad of a single glyph the same way DrawTextCodepoint places it.
+void countGlyphOverdraw(Layer layer, Font font, int index, float x, float y)
+{
+    countOverdraw(
+        layer,
+        x + font.glyphs[index].offsetX - font.glyphPadding,
+        y + font.glyphs[index].offsetY - font.glyphPadding,
+        font.recs[index].width + 2 * font.glyphPadding,
+        font.recs[index].height + 2 * font.glyphPadding);
+}
+
+// Counts a single line of text drawn with DrawTextEx at FONT_SIZE.
+void countTextOverdraw(Layer layer, Font font, const char *text, float x, float y)
+{
+    for (int i = 0; text[i];)
+    {
+        int size = 0;
+        int index = GetGlyphIndex(font, GetCodepoint(&text[i], &size));
+        if (text[i] != ' ' && text[i] != '\t') countGlyphOverdraw(layer, font, index, x, y);
+
+        x += font.glyphs[index].advanceX ? font.glyphs[index].advanceX : font.recs[index].width;
+        i += size;
+    }
+}
+
+void loadOverdraw()
+{
+    int size = (int)RENDER_WIDTH * (int)RENDER_HEIGHT;
+    overdraw.counts = calloc(size, 1);
+    overdraw.pixels = calloc(size, sizeof(Color));
+
+    Image image = GenImageColor(RENDER_WIDTH, RENDER_HEIGHT, BLANK);
+    overdraw.texture = loadTrackedTexture(image, "overdraw");
+    UnloadImage(image);
+}
+
+void unloadOverdraw()
+{
+    free(overdraw.counts);
+    free(overdraw.pixels);
+    unloadTrackedTexture(overdraw.texture);
+}
+
+void beginOverdraw()
+{
+    memset(overdraw.counts, 0, (int)RENDER_WIDTH * (int)RENDER_HEIGHT);
+    for (int i = 0; i < LAYER_COUNT; i++) overdraw.layerPixels[i] = 0;
+    overdraw.counting = true;
+}
+
+// Stops counting and draws the heatmap and the fill rate of each layer.
+void endOverdraw()
+{
+    overdraw.counting = false;
+
+    // 1 write is blue, going through green and yellow to red at 5 or more
+    const Color heat[] = {BLANK, BLUE, GREEN, YELLOW, ORANGE, RED};
+    int size = (int)RENDER_WIDTH * (int)RENDER_HEIGHT;
+    for (int i = 0; i < size; i++)
+    {
+        Color c = heat[overdraw.counts[i] < 5 ? overdraw.counts[i] : 5];
+        if (c.a) c.a = 128;
+        overdraw.pixels[i] = c;
+    }
+
+    UpdateTexture(overdraw.texture, overdraw.pixels);
+    DrawTexture(overdraw.texture, 0, 0, WHITE);
+
+    const char *names[LAYER_COUNT] = {"wallpaper", "shadow", "background", "chrome", "content", "taskbar"};
+    long total = 0;
+    for (int i = 0; i < LAYER_COUNT; i++) total += overdraw.layerPixels[i];
+
+    DrawText(TextFormat("Filled: %ld px (%.2fx screen)", total, (float)total / size), 0, 10, 10, WHITE);
+    for (int i = 0; i < LAYER_COUNT; i++)
+        DrawText(TextFormat("%s: %ld", names[i], overdraw.layerPixels[i]), 0, 20 + i * 10, 10, WHITE);
+}
+
 // _____________________________________________________________________________
 //
 // DrawTextRec was removed from raylib in 4.0, we need to re-implement it
@@ -44,6 +425,7 @@ static void DrawTextBoxedSelectable(Font font, const char *text, Rectangle rec,
         int codepointByteCount = 0;
         int codepoint = GetCodepoint(&text[i], &codepointByteCount);
         int index = GetGlyphIndex(font, codepoint);
+        countStat(layout, 1);
 
         // NOTE: Normally we exit the decoding sequence as soon as a bad byte is found (and return 0x3f)
         // but we need to draw all of the bad bytes using the '?' symbol moving one byte
@@ -122,6 +504,8 @@ static void DrawTextBoxedSelectable(Font font, const char *text, Rectangle rec,
                 if ((selectStart >= 0) && (k >= selectStart) && (k < (selectStart + selectLength)))
                 {
                     DrawRectangleRec((Rectangle){ rec.x + textOffsetX - 1, rec.y + textOffsetY, glyphWidth, (float)font.baseSize*scaleFactor }, selectBackTint);
+                    countStat(draws, 1);
+                    overdrawRect(LAYER_CONTENT, rec.x + textOffsetX - 1, rec.y + textOffsetY, glyphWidth, font.baseSize*scaleFactor);
                     isGlyphSelected = true;
                 }
 
@@ -129,6 +513,9 @@ static void DrawTextBoxedSelectable(Font font, const char *text, Rectangle rec,
                 if ((codepoint != ' ') && (codepoint != '\t'))
                 {
                     DrawTextCodepoint(font, codepoint, (Vector2){ rec.x + textOffsetX, rec.y + textOffsetY }, fontSize, isGlyphSelected? selectTint : tint);
+                    countStat(draws, 1);
+                    countStat(glyphs, 1);
+                    overdrawGlyph(LAYER_CONTENT, font, index, rec.x + textOffsetX, rec.y + textOffsetY);
                 }
             }
 
@@ -171,8 +558,11 @@ typedef struct Window
     bool resizable;
     Rectangle oldPos;   // old window coords are saved here when the window is maximized
     void (*function)(); // pointer to the function that is executed on this window every frame
-    void *data;         // storage for window related variables
+    void *data;         // storage for window related variables, see winAlloc
+    int dataSize;       // bytes allocated for data
+    unsigned int id;    // unique for every opened window, set by createWindow
     const char *title;
+    WindowStats stats;
 
     // for message boxes
     const char *message;
@@ -188,21 +578,44 @@ typedef enum
     IC_COUNT
 } Icon;
 
+// Keys that are read by rlwm, these are recorded as bits of Input.keys
+typedef enum
+{
+    IK_NEW_WINDOW,
+    IK_CAPTURE,
+    IK_COUNT
+} InputKey;
+
+const int inputKeys[IK_COUNT] = {KEY_A, KEY_C};
+
+// All input is read once per frame into this struct, so that sessions can be
+// recorded and replayed. Use the macros at the top instead of raylib's input functions.
+typedef struct Input
+{
+    Vector2 mouse;
+    bool lmbDown, lmbPressed, lmbReleased;
+    unsigned char keys; // pressed keys, see InputKey
+    float frameTime;
+} Input;
+
+Input input = {0};
+
 Font font = {0};
 Font boldFont = {0};
 Texture icons[IC_COUNT];
-Texture winButtons[8]; // close, maximize, minimize, etc
 Texture smallButtons[2];
 Texture largeButtons[2];
 Texture startButtons[2];
 
 Window windows[WINDOW_LIMIT + 1]; // last window slot is reserved, second to last window is focused
+unsigned int nextWindowId = 1;
 bool moving = false;              // is the focused window being moved?
 bool resizing = false;            // is the focused window being resized?
 Vector2 hook = {0};               // mouse position relative to the focused window when it is started to be moved
 
 int cursor = MOUSE_CURSOR_DEFAULT; // mouse cursor style, updated every frame
 char timebuf[16];                  // string to store current time
+char sizebuf[16];                  // title of the window being resized
 bool running = true;               // if set to false, clean up and exit
 
 // _____________________________________________________________________________
@@ -248,6 +661,27 @@ void winDrawText(Window *window, const char *text, int x, int y)
 void winDrawTexture(Window *window, Texture *texture, int x, int y)
 {
     DrawTexture(*texture, window->x + 2 + x, window->y + 16 + y, WHITE);
+    countStat(draws, 1);
+    overdrawRect(LAYER_CONTENT, window->x + 2 + x, window->y + 16 + y, texture->width, texture->height);
+}
+
+// Returns the storage of a window, allocating size zeroed bytes on the first call.
+// The storage is counted as memory of the window and freed when the window is closed.
+void *winAlloc(Window *window, int size)
+{
+    if (!window->data)
+    {
+        window->data = calloc(1, size);
+        window->dataSize = window->data ? size : 0;
+    }
+    return window->data;
+}
+
+void freeWindowData(Window *window)
+{
+    free(window->data);
+    window->data = NULL;
+    window->dataSize = 0;
 }
 
 // Draws a button inside a window, returns true if the button was clicked.
@@ -262,6 +696,171 @@ bool winButton(Window *window, int index, const char *text, int x, int y, bool l
     return hovered && lmbup;
 }
 
+// Runs the function of a window and accounts its cost to the window's stats.
+void runWindow(Window *window, int index)
+{
+    WindowStats *s = &window->stats;
+    s->draws = 0;
+    s->glyphs = 0;
+    s->layout = 0;
+
+    unsigned int id = window->id;
+    curStats = s;
+    double start = GetTime();
+    window->function(window, index);
+    double time = GetTime() - start;
+    curStats = NULL;
+
+    // the window may have closed itself and opened another one in the same slot
+    if (window->id != id) return;
+    s->time = time;
+
+    // exponential moving averages, peaks are kept for the lifetime of the window
+    s->avgTime += (s->time - s->avgTime) * STATS_SMOOTHING;
+    s->avgDraws += (s->draws - s->avgDraws) * STATS_SMOOTHING;
+    s->avgGlyphs += (s->glyphs - s->avgGlyphs) * STATS_SMOOTHING;
+    s->avgLayout += (s->layout - s->avgLayout) * STATS_SMOOTHING;
+
+    if (s->time > s->peakTime) s->peakTime = s->time;
+    if (s->draws > s->peakDraws) s->peakDraws = s->draws;
+    if (s->glyphs > s->peakGlyphs) s->peakGlyphs = s->glyphs;
+    if (s->layout > s->peakLayout) s->peakLayout = s->layout;
+}
+
+int windowMemory(Window *window);
+
+// Fills order with the indices of all active windows, most expensive first.
+// Returns the number of windows.
+int sortWindowsByCost(int *order)
+{
+    int count = 0;
+    for (int i = 0; i < WINDOW_LIMIT + 1; i++)
+    {
+        if (!windows[i].active) continue;
+
+        // insertion sort, there are only a few windows
+        int j = count++;
+        while (j > 0 && windows[order[j - 1]].stats.avgTime < windows[i].stats.avgTime)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    return count;
+}
+
+// Fills order with the indices of all active windows in the order they were
+// opened. Returns the number of windows.
+int sortWindowsById(int *order)
+{
+    int count = 0;
+    for (int i = 0; i < WINDOW_LIMIT + 1; i++)
+    {
+        if (!windows[i].active) continue;
+
+        int j = count++;
+        while (j > 0 && windows[order[j - 1]].id > windows[i].id)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    return count;
+}
+
+// Writes the stats of all active windows to a text file.
+bool dumpWindowStats(const char *fileName)
+{
+    FILE *f = fopen(fileName, "w");
+    if (!f) return false;
+
+    int order[WINDOW_LIMIT + 1];
+    int count = sortWindowsByCost(order);
+
+    fprintf(f, "# title, avg ms, peak ms, avg draws, peak draws, avg glyphs, peak glyphs, avg layout, peak layout, memory\n");
+    for (int i = 0; i < count; i++)
+    {
+        Window *win = &windows[order[i]];
+        WindowStats *s = &win->stats;
+        fprintf(
+            f, "%s, %.3f, %.3f, %.1f, %d, %.1f, %d, %.1f, %d, %d\n",
+            win->title, s->avgTime * 1000, s->peakTime * 1000,
+            s->avgDraws, s->peakDraws, s->avgGlyphs, s->peakGlyphs,
+            s->avgLayout, s->peakLayout, windowMemory(win));
+    }
+
+    fclose(f);
+    return true;
+}
+
+// While a window is being resized, its content is only laid out again
+// RESIZE_RELAYOUT_RATE times per second. In between, the last rendered
+// content is shown clipped to the new size.
+typedef struct ResizeCache
+{
+    RenderTexture target;
+    bool valid;
+    float age;         // frame time passed since the content was last rendered
+    int width, height; // size of the window at that time
+    unsigned int window; // id of the window the cache was rendered for
+} ResizeCache;
+
+ResizeCache resizeCache = {0};
+
+// Renders the content of a window into the resize cache.
+void renderResizeCache(Window *window, int index)
+{
+    // the cache may have been evicted, or may not fit at all, then the window is laid out every frame
+    if (!resizeCache.target.id)
+        loadTrackedRenderTexture(RENDER_WIDTH, RENDER_HEIGHT, "resize cache", &resizeCache.target);
+    if (!resizeCache.target.id) return;
+    useTexture(resizeCache.target.texture.id);
+
+    BeginTextureMode(resizeCache.target);
+    ClearBackground(WINDOW_BG_COLOR);
+
+    // window functions draw at the window's position, move it to the corner of the cache
+    BeginMode2D((Camera2D){.target = {window->x, window->y}, .zoom = 1.0f});
+    runWindow(window, index);
+    EndMode2D();
+
+    EndTextureMode();
+
+    resizeCache.valid = true;
+    resizeCache.age = 0;
+    resizeCache.width = window->width;
+    resizeCache.height = window->height;
+    resizeCache.window = window->id;
+}
+
+// Draws the cached content of a window, clipped to its current size.
+void drawResizeCache(Window *window)
+{
+    useTexture(resizeCache.target.texture.id);
+
+    int width = resizeCache.width < window->width ? resizeCache.width : window->width;
+    int height = resizeCache.height < window->height ? resizeCache.height : window->height;
+
+    // render textures are upside down, so the top of the cache is at the bottom of the texture
+    DrawTextureRec(
+        resizeCache.target.texture,
+        (Rectangle){0, resizeCache.target.texture.height - height, width, -(height - 15)},
+        (Vector2){window->x, window->y + 15}, WHITE);
+    overdrawRect(LAYER_CONTENT, window->x, window->y + 15, width, height - 15);
+}
+
+// Returns the memory owned by a window in bytes: its data and the resize cache
+// if it was last rendered for this window.
+int windowMemory(Window *window)
+{
+    int bytes = window->dataSize;
+    if (resizeCache.target.id && resizeCache.window == window->id)
+        bytes += trackedBytes(resizeCache.target.texture.id);
+    return bytes;
+}
+
 void messageBoxWindow(Window *window, int index);
 
 // Opens a new window.
@@ -270,6 +869,7 @@ bool createWindow(Window window)
     window.active = true;
     window.minimized = false;
     window.maximized = false;
+    window.id = nextWindowId++;
 
     // find a free window slot
     int slot = -1;
@@ -279,6 +879,7 @@ bool createWindow(Window window)
     if (slot != -1)
     {
         // if a slot was found, assign it to the window and focus it
+        freeWindowData(&windows[slot]);
         windows[slot] = window;
         focusWindow(slot);
         return true;
@@ -286,12 +887,14 @@ bool createWindow(Window window)
     else
     {
         // if all window slots are taken, show an error message
+        freeWindowData(&windows[WINDOW_LIMIT]);
         windows[WINDOW_LIMIT] = (Window){
             .x = RENDER_WIDTH / 2 - 100,
             .y = RENDER_HEIGHT / 2 - 50,
             .width = 200,
             .height = 100,
             .active = true,
+            .id = nextWindowId++,
             .function = messageBoxWindow,
             .title = "Error",
             .message = "Out of window slots! Close some windows and try again.",
@@ -329,12 +932,53 @@ void endSessionWindow(Window *window, int index)
 // Window used for demonstrating window-bound variable storage.
 void testWindow(Window *window, int index)
 {
-    winDrawText(window, TextFormat("%d", window->data), 0, 0);
+    int *value = winAlloc(window, sizeof(int));
+    if (!value) return;
+
+    winDrawText(window, TextFormat("%d", *value), 0, 0);
 
     if (winButton(window, index, "Increase", 0, 20, 1))
-        window->data++;
+        (*value)++;
     if (winButton(window, index, "Decrease", 0, 36, 1))
-        window->data--;
+        (*value)--;
+}
+
+// Lists all windows and allows closing them. The rows stay in the order the
+// windows were opened, sorting them by measured time would move them differently
+// when a session is replayed, and recorded clicks would land on other rows.
+// The most expensive window is marked instead. The dump is sorted by cost.
+void taskManagerWindow(Window *window, int index)
+{
+    int order[WINDOW_LIMIT + 1];
+    int count = sortWindowsById(order);
+
+    int costliest = -1;
+    for (int r = 0; r < count; r++)
+        if (costliest < 0 || windows[order[r]].stats.avgTime > windows[order[costliest]].stats.avgTime)
+            costliest = r;
+
+    winDrawText(window, "Window", 0, 0);
+    winDrawText(window, "ms avg/peak", 100, 0);
+    winDrawText(window, "draws/glyphs", 170, 0);
+    winDrawText(window, "mem", 240, 0);
+
+    for (int r = 0; r < count; r++)
+    {
+        Window *win = &windows[order[r]];
+        WindowStats *s = &win->stats;
+        int y = 14 + r * 16;
+
+        winDrawText(window, r == costliest ? TextFormat("* %s", win->title) : win->title, 0, y + 2);
+        winDrawText(window, TextFormat("%.2f/%.2f", s->avgTime * 1000, s->peakTime * 1000), 100, y + 2);
+        winDrawText(window, TextFormat("%.0f/%.0f", s->avgDraws, s->avgGlyphs), 170, y + 2);
+        winDrawText(window, TextFormat("%dK", windowMemory(win) / 1024), 240, y + 2);
+
+        if (winButton(window, index, "End", 284, y, false))
+            win->active = false;
+    }
+
+    if (winButton(window, index, "Dump", 0, 14 + count * 16 + 4, false))
+        dumpWindowStats(STATS_DUMP_FILE);
 }
 
 void startMenuWindow(Window *window, int index)
@@ -380,88 +1024,913 @@ void startMenuWindow(Window *window, int index)
             .title = "window.data test",
             .function = testWindow});
     }
+
+    if (winButton(window, index, "Task manager", 0, 32, true))
+    {
+        window->active = false;
+
+        createWindow((Window){
+            .x = RENDER_WIDTH / 2 - 170,
+            .y = RENDER_HEIGHT / 2 - 110,
+            .width = 340,
+            .height = 220,
+            .minWidth = 340,
+            // titlebar, header, a row for every window slot and the Dump button
+            .minHeight = 16 + 14 + (WINDOW_LIMIT + 1) * 16 + 4 + 16,
+            .resizable = true,
+            .title = "Task manager",
+            .function = taskManagerWindow});
+    }
 }
 
 // _____________________________________________________________________________
 //
-//  Main
+//  Window chrome
 // _____________________________________________________________________________
 //
 
-int main()
-{
-    InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "rlwm");
-    SetTargetFPS(60);
-    SetWindowIcon(LoadImage(TextFormat("%s/logo.png", ASSETS_FOLDER)));
-    SetMouseScale(1 / SCALE, 1 / SCALE);
+// The frames of all windows (shadow, background, titlebar and buttons) are kept
+// in one persistent vertex buffer, with a fixed range of vertices for each
+// window slot. A range is only rebuilt when the geometry, focus or button state
+// of the window in that slot changes. The buffer holds all frames first and
+// then all buttons, so a run of neighbouring slots can be drawn with one call
+// per layer. Hidden slots are kept as empty quads so they don't break runs.
 
-    RenderTexture rt = LoadRenderTexture(RENDER_WIDTH, RENDER_HEIGHT);
+#define CHROME_FRAME_VERTICES (3 * 6)  // shadow, background and titlebar quads
+#define CHROME_BUTTON_VERTICES (3 * 6) // close, maximize and minimize quads
+#define CHROME_VERTICES (CHROME_FRAME_VERTICES + CHROME_BUTTON_VERTICES)
+#define CHROME_SLOTS (WINDOW_LIMIT + 1)
 
-    if (FULLSCREEN) ToggleFullscreen();
+// first vertex of the frame and button quads of a slot
+#define chromeFrames(slot) ((slot) * CHROME_FRAME_VERTICES)
+#define chromeButtons(slot) (CHROME_SLOTS * CHROME_FRAME_VERTICES + (slot) * CHROME_BUTTON_VERTICES)
 
-    font = LoadFontEx(TextFormat("%s/font.ttf", ASSETS_FOLDER), FONT_SIZE, NULL, 95);
-    boldFont = LoadFontEx(TextFormat("%s/font_bold.ttf", ASSETS_FOLDER), FONT_SIZE, NULL, 95);
+// ints rather than bools so the struct has no padding and can be memcmp'd
+typedef struct ChromeKey
+{
+    int visible;
+    int x, y, width, height;
+    int focused;
+    int buttons[3]; // sprite index of the close, maximize and minimize buttons
+} ChromeKey;
 
-    Texture bg = LoadTexture(TextFormat("%s/bg.png", ASSETS_FOLDER));
+typedef struct Chrome
+{
+    unsigned int vao;
+    unsigned int positionBuffer, texcoordBuffer, colorBuffer;
+    int mvpLoc, colorLoc, textureLoc;
+    int positionAttrib, texcoordAttrib, colorAttrib;
 
-    // _________________________________________________________________________
-    //
-    //  Load button images
-    // _________________________________________________________________________
-    //
+    Texture atlas; // button sprites with a white texel below them for the solid quads
+    Vector2 white; // texture coordinates of the white texel
 
-    Image buttonImage = LoadImage(TextFormat("%s/buttons.png", ASSETS_FOLDER));
+    ChromeKey keys[CHROME_SLOTS];
+    bool built[CHROME_SLOTS];
 
-    // window control buttons
-    for (int i = 0; i < 8; i++)
-    {
-        Image button = ImageCopy(buttonImage);
-        ImageCrop(&button, (Rectangle){i * 12, 0, 12, 12});
-        winButtons[i] = LoadTextureFromImage(button);
-        UnloadImage(button);
-    }
+    float positions[CHROME_SLOTS * CHROME_VERTICES * 2];
+    float texcoords[CHROME_SLOTS * CHROME_VERTICES * 2];
+    unsigned char colors[CHROME_SLOTS * CHROME_VERTICES * 4];
+} Chrome;
 
-    for (int i = 0; i < 2; i++)
-    {
-        // small buttons (48 × 16)
-        Image sbutton = ImageCopy(buttonImage);
-        ImageCrop(&sbutton, (Rectangle){i * 48, 12, 48, 16});
-        smallButtons[i] = LoadTextureFromImage(sbutton);
-        UnloadImage(sbutton);
+Chrome chrome = {0};
 
-        // large buttons (96 × 16)
-        Image lbutton = ImageCopy(buttonImage);
-        ImageCrop(&lbutton, (Rectangle){0, 28 + i * 16, 96, 16});
-        largeButtons[i] = LoadTextureFromImage(lbutton);
-        UnloadImage(lbutton);
+static void bindChromeAttributes()
+{
+    rlEnableVertexBuffer(chrome.positionBuffer);
+    rlSetVertexAttribute(chrome.positionAttrib, 2, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(chrome.positionAttrib);
 
-        // start buttons (48 × 16)
-        Image stbutton = ImageCopy(buttonImage);
-        ImageCrop(&stbutton, (Rectangle){i * 48, 60, 48, 16});
-        startButtons[i] = LoadTextureFromImage(stbutton);
-        UnloadImage(stbutton);
-    }
+    rlEnableVertexBuffer(chrome.texcoordBuffer);
+    rlSetVertexAttribute(chrome.texcoordAttrib, 2, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(chrome.texcoordAttrib);
 
-    UnloadImage(buttonImage);
+    rlEnableVertexBuffer(chrome.colorBuffer);
+    rlSetVertexAttribute(chrome.colorAttrib, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+    rlEnableVertexAttribute(chrome.colorAttrib);
+}
 
-    // _________________________________________________________________________
-    //
-    //  Load icons
-    // _________________________________________________________________________
-    //
+// Creates the chrome vertex buffer and the sprite atlas from the buttons image.
+void loadChrome(Image buttonImage)
+{
+    Image atlas = ImageCopy(buttonImage);
+    ImageResizeCanvas(&atlas, atlas.width, atlas.height + 1, 0, 0, WHITE);
+    chrome.atlas = loadTrackedTexture(atlas, "chrome");
+    chrome.white = (Vector2){0.5f / atlas.width, (atlas.height - 0.5f) / atlas.height};
+    UnloadImage(atlas);
+
+    unsigned int shader = rlGetShaderIdDefault();
+    chrome.mvpLoc = rlGetLocationUniform(shader, "mvp");
+    chrome.colorLoc = rlGetLocationUniform(shader, "colDiffuse");
+    chrome.textureLoc = rlGetLocationUniform(shader, "texture0");
+    chrome.positionAttrib = rlGetLocationAttrib(shader, "vertexPosition");
+    chrome.texcoordAttrib = rlGetLocationAttrib(shader, "vertexTexCoord");
+    chrome.colorAttrib = rlGetLocationAttrib(shader, "vertexColor");
+
+    chrome.vao = rlLoadVertexArray();
+    rlEnableVertexArray(chrome.vao);
+    chrome.positionBuffer = loadTrackedVertexBuffer(chrome.positions, sizeof(chrome.positions), true, "chrome");
+    chrome.texcoordBuffer = loadTrackedVertexBuffer(chrome.texcoords, sizeof(chrome.texcoords), true, "chrome");
+    chrome.colorBuffer = loadTrackedVertexBuffer(chrome.colors, sizeof(chrome.colors), true, "chrome");
+    bindChromeAttributes();
+    rlDisableVertexArray();
+}
 
-    Image iconImage = LoadImage(TextFormat("%s/icons.png", ASSETS_FOLDER));
+void unloadChrome()
+{
+    rlUnloadVertexArray(chrome.vao);
+    unloadTrackedVertexBuffer(chrome.positionBuffer);
+    unloadTrackedVertexBuffer(chrome.texcoordBuffer);
+    unloadTrackedVertexBuffer(chrome.colorBuffer);
+    unloadTrackedTexture(chrome.atlas);
+}
+
+// Writes a quad as two triangles at vertex v of the chrome buffers.
+static void chromeQuad(int v, Rectangle rec, Rectangle uv, Color color)
+{
+    float x[6] = {rec.x, rec.x, rec.x + rec.width, rec.x, rec.x + rec.width, rec.x + rec.width};
+    float y[6] = {rec.y, rec.y + rec.height, rec.y + rec.height, rec.y, rec.y + rec.height, rec.y};
+    float u[6] = {uv.x, uv.x, uv.x + uv.width, uv.x, uv.x + uv.width, uv.x + uv.width};
+    float t[6] = {uv.y, uv.y + uv.height, uv.y + uv.height, uv.y, uv.y + uv.height, uv.y};
+
+    for (int i = 0; i < 6; i++)
+    {
+        chrome.positions[(v + i) * 2] = x[i];
+        chrome.positions[(v + i) * 2 + 1] = y[i];
+        chrome.texcoords[(v + i) * 2] = u[i];
+        chrome.texcoords[(v + i) * 2 + 1] = t[i];
+        chrome.colors[(v + i) * 4] = color.r;
+        chrome.colors[(v + i) * 4 + 1] = color.g;
+        chrome.colors[(v + i) * 4 + 2] = color.b;
+        chrome.colors[(v + i) * 4 + 3] = color.a;
+    }
+}
+
+// Rebuilds the chrome of a window slot if its state has changed since the last frame.
+void updateChrome(int slot, ChromeKey key)
+{
+    if (chrome.built[slot] && !memcmp(&chrome.keys[slot], &key, sizeof(ChromeKey))) return;
+
+    chrome.keys[slot] = key;
+    chrome.built[slot] = true;
+
+    int f = chromeFrames(slot);
+    int b = chromeButtons(slot);
+    Rectangle solid = {chrome.white.x, chrome.white.y, 0, 0};
+
+    if (!key.visible)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            chromeQuad(f + i * 6, (Rectangle){0}, solid, BLANK);
+            chromeQuad(b + i * 6, (Rectangle){0}, solid, BLANK);
+        }
+    }
+    else
+    {
+        chromeQuad(
+            f, (Rectangle){key.x + SHADOW_OFFSET.x, key.y + SHADOW_OFFSET.y, key.width, key.height},
+            solid, SHADOW_COLOR);
+        chromeQuad(f + 6, (Rectangle){key.x, key.y, key.width, key.height}, solid, WINDOW_BG_COLOR);
+        chromeQuad(
+            f + 12, (Rectangle){key.x + 1, key.y + 1, key.width - 2, 14},
+            solid, key.focused ? TITLE_BG_COLOR : TITLE_UNFOCUSED_COLOR);
+
+        // buttons are 12 × 12 sprites in the top row of the atlas
+        for (int i = 0; i < 3; i++)
+        {
+            Rectangle uv = {
+                key.buttons[i] * 12.0f / chrome.atlas.width, 0,
+                12.0f / chrome.atlas.width, 12.0f / chrome.atlas.height};
+            chromeQuad(b + i * 6, (Rectangle){key.x + key.width - 14 - i * 13, key.y + 2, 12, 12}, uv, WHITE);
+        }
+    }
+
+    int fsize = CHROME_FRAME_VERTICES * 2 * sizeof(float);
+    int bsize = CHROME_BUTTON_VERTICES * 2 * sizeof(float);
+    rlUpdateVertexBuffer(chrome.positionBuffer, &chrome.positions[f * 2], fsize, f * 2 * sizeof(float));
+    rlUpdateVertexBuffer(chrome.positionBuffer, &chrome.positions[b * 2], bsize, b * 2 * sizeof(float));
+    rlUpdateVertexBuffer(chrome.texcoordBuffer, &chrome.texcoords[f * 2], fsize, f * 2 * sizeof(float));
+    rlUpdateVertexBuffer(chrome.texcoordBuffer, &chrome.texcoords[b * 2], bsize, b * 2 * sizeof(float));
+    rlUpdateVertexBuffer(chrome.colorBuffer, &chrome.colors[f * 4], CHROME_FRAME_VERTICES * 4, f * 4);
+    rlUpdateVertexBuffer(chrome.colorBuffer, &chrome.colors[b * 4], CHROME_BUTTON_VERTICES * 4, b * 4);
+}
+
+// Returns the end of a run of slots starting at first, in which no two visible
+// windows overlap. Their chrome can then be drawn layer by layer for the whole
+// run without changing how the windows stack, as long as the content of each
+// window is clipped to it and geometry changes wait until the run is drawn.
+int chromeRunEnd(const Rectangle *bounds, const bool *visible, int first, int count)
+{
+    int end = first + 1;
+    for (; end < count; end++)
+    {
+        if (!visible[end]) continue;
+
+        for (int i = first; i < end; i++)
+            if (visible[i] && CheckCollisionRecs(bounds[i], bounds[end])) return end;
+    }
+    return end;
+}
+
+// Draws a range of vertices of the chrome buffer with one draw call.
+void drawChrome(int first, int count)
+{
+    // anything drawn before has to reach the screen first to keep the stacking order
+    rlDrawRenderBatchActive();
+
+    rlEnableShader(rlGetShaderIdDefault());
+    rlSetUniformMatrix(chrome.mvpLoc, MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection()));
+    rlSetUniform(chrome.colorLoc, (float[4]){1.0f, 1.0f, 1.0f, 1.0f}, RL_SHADER_UNIFORM_VEC4, 1);
+    rlSetUniform(chrome.textureLoc, (int[1]){0}, RL_SHADER_UNIFORM_INT, 1);
+
+    rlActiveTextureSlot(0);
+    rlEnableTexture(chrome.atlas.id);
+
+    // without vertex array object support, the attributes are bound on every draw
+    if (!rlEnableVertexArray(chrome.vao)) bindChromeAttributes();
+    rlDrawVertexArray(first, count);
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+
+    rlDisableTexture();
+    rlDisableShader();
+}
+
+// _____________________________________________________________________________
+//
+//  Screen capture
+// _____________________________________________________________________________
+//
+
+// Finished frames are copied on the GPU into a ring of CAPTURE_SLOTS render
+// textures. Before a copy is overwritten it is read back. The readback itself
+// is synchronous, rlgl has no pixel buffer objects to make it asynchronous,
+// but the copy was made CAPTURE_SLOTS frames ago, so it doesn't have to wait
+// for the frame being drawn. Its cost is shown separately in the capture stats.
+// Read back frames are queued for a worker thread that encodes them to a PNG
+// sequence. If the queue is full, the frame is dropped instead of stalling.
+typedef struct Capture
+{
+    bool active;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool quit;
+
+    RenderTexture targets[CAPTURE_SLOTS]; // ring of frame copies on the GPU
+    int targetFrame[CAPTURE_SLOTS];       // frame copied into each target, -1 if none
+
+    Image queue[CAPTURE_SLOTS]; // read back frames, in order of capture
+    int queueFrame[CAPTURE_SLOTS];
+    int head, count;
+
+    Image last;    // last encoded frame, used to skip unchanged frames (worker only)
+    char name[64]; // file name prefix of this recording, includes its start time
+
+    int frame;       // frames seen since capture started
+    int dropped;     // frames dropped because the encoder fell behind
+    double overhead; // rolling average of seconds spent on capture per frame
+    double readback; // rolling average of seconds of that spent reading back
+
+    // written by the worker under the lock, copied to the shown counters for the render thread
+    int written, skipped;
+    int shownWritten, shownSkipped;
+} Capture;
+
+Capture capture = {0};
+
+static void *captureWorker(void *arg)
+{
+    (void)arg;
+
+    while (true)
+    {
+        pthread_mutex_lock(&capture.lock);
+        while (!capture.count && !capture.quit)
+            pthread_cond_wait(&capture.cond, &capture.lock);
+
+        if (!capture.count)
+        {
+            pthread_mutex_unlock(&capture.lock);
+            break;
+        }
+
+        int tail = (capture.head - capture.count + CAPTURE_SLOTS) % CAPTURE_SLOTS;
+        Image image = capture.queue[tail];
+        int frame = capture.queueFrame[tail];
+        pthread_mutex_unlock(&capture.lock);
+
+        int size = GetPixelDataSize(image.width, image.height, image.format);
+        bool unchanged = capture.last.data && !memcmp(capture.last.data, image.data, size);
+
+        if (!unchanged)
+        {
+            // the frame number is kept in the name so skipped and dropped frames can be told apart
+            char fileName[96];
+            snprintf(fileName, sizeof(fileName), "%s%05d.png", capture.name, frame);
+            ExportImage(image, fileName);
+        }
+
+        UnloadImage(capture.last);
+        capture.last = image;
+
+        pthread_mutex_lock(&capture.lock);
+        capture.count--;
+        if (unchanged) capture.skipped++;
+        else capture.written++;
+        pthread_cond_broadcast(&capture.cond);
+        pthread_mutex_unlock(&capture.lock);
+    }
+
+    return NULL;
+}
+
+// Reads back a capture target and queues it for encoding. If wait is false and
+// the queue is full, the frame is dropped, otherwise this waits for the encoder.
+static void readbackCapture(int slot, bool wait)
+{
+    pthread_mutex_lock(&capture.lock);
+    bool full = capture.count == CAPTURE_SLOTS;
+    pthread_mutex_unlock(&capture.lock);
+
+    if (full && !wait)
+        capture.dropped++;
+    else
+    {
+        double start = GetTime();
+        Image image = LoadImageFromTexture(capture.targets[slot].texture);
+        capture.readback += (GetTime() - start - capture.readback) * STATS_SMOOTHING;
+
+        pthread_mutex_lock(&capture.lock);
+        while (capture.count == CAPTURE_SLOTS)
+            pthread_cond_wait(&capture.cond, &capture.lock);
+
+        capture.queue[capture.head] = image;
+        capture.queueFrame[capture.head] = capture.targetFrame[slot];
+        capture.head = (capture.head + 1) % CAPTURE_SLOTS;
+        capture.count++;
+        pthread_cond_broadcast(&capture.cond);
+        pthread_mutex_unlock(&capture.lock);
+    }
+
+    capture.targetFrame[slot] = -1;
+}
+
+void startCapture()
+{
+    capture = (Capture){.active = true};
+    pthread_mutex_init(&capture.lock, NULL);
+    pthread_cond_init(&capture.cond, NULL);
+
+    // every recording gets its own file names, so an earlier one is never overwritten
+    char stamp[32];
+    time_t t = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime(&t));
+    snprintf(capture.name, sizeof(capture.name), "%s%s_", CAPTURE_PREFIX, stamp);
+
+    for (int i = 0; i < CAPTURE_SLOTS; i++)
+    {
+        capture.targets[i] = loadTrackedRenderTexture(RENDER_WIDTH, RENDER_HEIGHT, "capture", NULL);
+        capture.targetFrame[i] = -1;
+    }
+
+    if (pthread_create(&capture.thread, NULL, captureWorker, NULL))
+    {
+        TraceLog(LOG_WARNING, "CAPTURE: Failed to start encoder thread");
+        for (int i = 0; i < CAPTURE_SLOTS; i++) unloadTrackedRenderTexture(capture.targets[i]);
+        capture.active = false;
+    }
+}
+
+// Stops capturing, waits for the remaining frames to be written.
+void stopCapture()
+{
+    // the copies still on the GPU are read back oldest first
+    for (int i = 0; i < CAPTURE_SLOTS; i++)
+    {
+        int slot = (capture.frame + i) % CAPTURE_SLOTS;
+        if (capture.targetFrame[slot] >= 0) readbackCapture(slot, true);
+    }
+
+    pthread_mutex_lock(&capture.lock);
+    capture.quit = true;
+    pthread_cond_broadcast(&capture.cond);
+    pthread_mutex_unlock(&capture.lock);
+
+    pthread_join(capture.thread, NULL);
+    pthread_mutex_destroy(&capture.lock);
+    pthread_cond_destroy(&capture.cond);
+
+    for (int i = 0; i < CAPTURE_SLOTS; i++) unloadTrackedRenderTexture(capture.targets[i]);
+    UnloadImage(capture.last);
+    capture.last = (Image){0};
+    capture.active = false;
+}
+
+// Copies the finished frame into the capture ring, and reads back the oldest copy.
+void captureFrame(RenderTexture *source)
+{
+    double start = GetTime();
+    int slot = capture.frame % CAPTURE_SLOTS;
+
+    if (capture.targetFrame[slot] >= 0) readbackCapture(slot, false);
+
+    // copied without flipping, the copy ends up stored top to bottom and reads back upright
+    BeginTextureMode(capture.targets[slot]);
+    DrawTexture(source->texture, 0, 0, WHITE);
+    EndTextureMode();
+    capture.targetFrame[slot] = capture.frame;
+    capture.frame++;
+
+    pthread_mutex_lock(&capture.lock);
+    capture.shownWritten = capture.written;
+    capture.shownSkipped = capture.skipped;
+    pthread_mutex_unlock(&capture.lock);
+
+    capture.overhead += (GetTime() - start - capture.overhead) * STATS_SMOOTHING;
+}
+
+// _____________________________________________________________________________
+//
+//  Rendering
+// _____________________________________________________________________________
+//
+
+// Draws the tiled/scaled wallpaper over the whole desktop.
+void drawWallpaper(Texture bg, int width, int height)
+{
+    if (TILED_BACKGROUND)
+    {
+        DrawTextureTiled(
+            bg, (Rectangle){0, 0, bg.width, bg.height},
+            (Rectangle){0, 0, width, height},
+            (Vector2){0, 0}, 0.0f, 1.0f, WHITE);
+    }
+    else
+    {
+        DrawTexturePro(
+            bg, (Rectangle){0, 0, bg.width, bg.height},
+            (Rectangle){0, 0, width, height},
+            (Vector2){0, 0}, 0.0f, WHITE);
+    }
+}
+
+// Compares frame time and fill rate of the render texture path and the direct
+// path at a few window sizes. The scene is the wallpaper and a full set of
+// overlapping window frames. Run with --bench-render. Only the frame time is
+// measured, the fill rate is estimated from the pixels the scene should write.
+void benchmarkRender(Texture bg)
+{
+    const int sizes[][2] = {{640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+    const int frames = 300;
+
+    SetTargetFPS(0);
+    printf("%-11s %-8s %10s %14s %10s\n", "size", "path", "frame ms", "est Mpix/frame", "est Gpix/s");
+
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+    {
+        SetWindowSize(sizes[s][0], sizes[s][1]);
+
+        // let the window system apply the new size, it may be clamped to the monitor
+        for (int i = 0; i < 10; i++)
+        {
+            BeginDrawing();
+            EndDrawing();
+        }
+
+        int width = GetScreenWidth();
+        int height = GetScreenHeight();
+        int rwidth = width / SCALE;
+        int rheight = height / SCALE;
+
+        // not tracked, the benchmark runs before the desktop and its target is full screen sized
+        RenderTexture target = LoadRenderTexture(rwidth, rheight);
+        Camera2D camera = {.zoom = SCALE};
+
+        // pixels written per frame at render resolution: wallpaper, shadow and background of each window
+        double scenePixels = (double)rwidth * rheight + WINDOW_LIMIT * 2 * 200 * 100;
+
+        for (int direct = 0; direct < 2; direct++)
+        {
+            if (direct && SCALE != (int)SCALE) continue;
+
+            double start = GetTime();
+            for (int f = 0; f < frames; f++)
+            {
+                if (direct)
+                {
+                    BeginDrawing();
+                    BeginMode2D(camera);
+                }
+                else BeginTextureMode(target);
+
+                drawWallpaper(bg, rwidth, rheight);
+                for (int i = 0; i < WINDOW_LIMIT; i++)
+                {
+                    int x = (i * 37) % (rwidth - 200);
+                    int y = (i * 23) % (rheight - 100);
+                    DrawRectangle(x + SHADOW_OFFSET.x, y + SHADOW_OFFSET.y, 200, 100, SHADOW_COLOR);
+                    DrawRectangle(x, y, 200, 100, WINDOW_BG_COLOR);
+                }
+
+                if (direct) EndMode2D();
+                else
+                {
+                    EndTextureMode();
+                    BeginDrawing();
+                    DrawTexturePro(
+                        target.texture,
+                        (Rectangle){0, 0, rwidth, -rheight},
+                        (Rectangle){0, 0, width, height},
+                        (Vector2){0, 0}, 0.0f, WHITE);
+                }
+                EndDrawing();
+            }
+            double frameTime = (GetTime() - start) / frames;
+
+            // the direct path fills every scene pixel at screen resolution,
+            // the render texture path fills them at render resolution and then blits the whole screen
+            double pixels = direct ? scenePixels * SCALE * SCALE : scenePixels + (double)width * height;
+
+            printf(
+                "%5dx%-5d %-8s %10.3f %14.2f %10.2f\n", width, height, direct ? "direct" : "texture",
+                frameTime * 1000, pixels / 1e6, pixels / frameTime / 1e9);
+        }
+
+        UnloadRenderTexture(target);
+    }
+
+    SetTargetFPS(60);
+}
+
+// Compares drawing the chrome of a full set of windows in immediate mode and
+// from the chrome buffer, for overlapping (cascaded) and non-overlapping (tiled)
+// windows. The chrome time is the CPU time spent issuing the chrome draws,
+// including flushing the immediate mode batch. Run with --bench-render.
+void benchmarkChrome()
+{
+    const int frames = 1000;
+    Camera2D camera = {.zoom = SCALE};
+
+    SetTargetFPS(0);
+    SetWindowSize(SCREEN_WIDTH, SCREEN_HEIGHT);
+    printf("\n%-9s %-10s %10s %10s\n", "layout", "chrome", "chrome ms", "frame ms");
+
+    for (int tiled = 0; tiled < 2; tiled++)
+    {
+        ChromeKey keys[CHROME_SLOTS];
+        Rectangle bounds[CHROME_SLOTS];
+        bool visible[CHROME_SLOTS];
+        for (int i = 0; i < CHROME_SLOTS; i++)
+        {
+            int x = tiled ? (i % 3) * 165 : i * 16;
+            int y = tiled ? (i / 3) * 115 : i * 16;
+            keys[i] = (ChromeKey){
+                .visible = true,
+                .x = x,
+                .y = y,
+                .width = 150,
+                .height = 100,
+                .focused = i == CHROME_SLOTS - 1,
+                .buttons = {3, 1, 0}};
+            bounds[i] = (Rectangle){x, y, 150 + SHADOW_OFFSET.x, 100 + SHADOW_OFFSET.y};
+            visible[i] = true;
+        }
+
+        for (int buffered = 0; buffered < 2; buffered++)
+        {
+            double chromeTime = 0;
+            double start = GetTime();
+
+            for (int f = 0; f < frames; f++)
+            {
+                BeginDrawing();
+                ClearBackground(BLACK);
+                BeginMode2D(camera);
+
+                double t = GetTime();
+                if (buffered)
+                {
+                    for (int first = 0; first < CHROME_SLOTS;)
+                    {
+                        int last = chromeRunEnd(bounds, visible, first, CHROME_SLOTS);
+                        for (int i = first; i < last; i++) updateChrome(i, keys[i]);
+                        drawChrome(chromeFrames(first), (last - first) * CHROME_FRAME_VERTICES);
+                        drawChrome(chromeButtons(first), (last - first) * CHROME_BUTTON_VERTICES);
+                        first = last;
+                    }
+                }
+                else
+                {
+                    for (int i = 0; i < CHROME_SLOTS; i++)
+                    {
+                        ChromeKey k = keys[i];
+                        DrawRectangle(k.x + SHADOW_OFFSET.x, k.y + SHADOW_OFFSET.y, k.width, k.height, SHADOW_COLOR);
+                        DrawRectangle(k.x, k.y, k.width, k.height, WINDOW_BG_COLOR);
+                        DrawRectangle(k.x + 1, k.y + 1, k.width - 2, 14, k.focused ? TITLE_BG_COLOR : TITLE_UNFOCUSED_COLOR);
+                        for (int b = 0; b < 3; b++)
+                        {
+                            DrawTextureRec(
+                                chrome.atlas, (Rectangle){k.buttons[b] * 12, 0, 12, 12},
+                                (Vector2){k.x + k.width - 14 - b * 13, k.y + 2}, WHITE);
+                        }
+                    }
+                    rlDrawRenderBatchActive();
+                }
+                chromeTime += GetTime() - t;
+
+                EndMode2D();
+                EndDrawing();
+            }
+
+            printf(
+                "%-9s %-10s %10.4f %10.3f\n", tiled ? "tiled" : "cascaded", buffered ? "buffer" : "immediate",
+                chromeTime / frames * 1000, (GetTime() - start) / frames * 1000);
+        }
+    }
+
+    SetTargetFPS(60);
+}
+
+// _____________________________________________________________________________
+//
+//  Session recording
+// _____________________________________________________________________________
+//
+
+// A session log starts with a header holding the random seed, followed by one
+// record per frame with the input state and the frame time. Run with
+// --record <file> to write a log and --replay <file> [--fast] to play it back,
+// either paced to the recorded frame times or as fast as possible.
+
+#define SESSION_MAGIC "RLWS"
+#define SESSION_VERSION 1
+
+typedef struct Session
+{
+    FILE *file;
+    bool recording, replaying;
+    bool fast;           // replay without waiting for the recorded frame times
+    double frameStart;   // when the current replayed frame started
+    float *frameTimes;   // measured frame times while replaying, without pacing
+    double recordedTime; // sum of the frame times in the log
+    int frames, capacity;
+} Session;
+
+Session session = {0};
+
+bool startRecording(const char *fileName, unsigned int seed)
+{
+    session.file = fopen(fileName, "wb");
+    if (!session.file) return false;
+
+    unsigned short version = SESSION_VERSION;
+    fwrite(SESSION_MAGIC, 1, 4, session.file);
+    fwrite(&version, sizeof(version), 1, session.file);
+    fwrite(&seed, sizeof(seed), 1, session.file);
+
+    session.recording = true;
+    return true;
+}
+
+// Opens a session log for replaying, returns false if it can't be read.
+bool startReplay(const char *fileName, unsigned int *seed)
+{
+    session.file = fopen(fileName, "rb");
+    if (!session.file) return false;
+
+    char magic[4];
+    unsigned short version;
+    if (fread(magic, 1, 4, session.file) != 4 || memcmp(magic, SESSION_MAGIC, 4) ||
+        fread(&version, sizeof(version), 1, session.file) != 1 || version != SESSION_VERSION ||
+        fread(seed, sizeof(*seed), 1, session.file) != 1)
+    {
+        fclose(session.file);
+        session.file = NULL;
+        return false;
+    }
+
+    session.replaying = true;
+    return true;
+}
+
+// Reads the input for this frame, from the log when replaying and from raylib
+// otherwise. Returns false when the log has ended.
+bool pollInput()
+{
+    if (session.replaying)
+    {
+        unsigned char buttons;
+        bool ok =
+            fread(&input.mouse.x, sizeof(float), 1, session.file) &&
+            fread(&input.mouse.y, sizeof(float), 1, session.file) &&
+            fread(&buttons, 1, 1, session.file) &&
+            fread(&input.keys, 1, 1, session.file) &&
+            fread(&input.frameTime, sizeof(float), 1, session.file);
+        if (!ok) return false;
+
+        input.lmbDown = buttons & 1;
+        input.lmbPressed = buttons & 2;
+        input.lmbReleased = buttons & 4;
+
+        // the recorded frame time is the length of the previous frame, so the previous
+        // frame is measured here and then padded to that length
+        if (session.frames > 0)
+        {
+            if (session.frames > session.capacity)
+            {
+                session.capacity = session.capacity ? session.capacity * 2 : 1024;
+                session.frameTimes = realloc(session.frameTimes, session.capacity * sizeof(float));
+            }
+            session.frameTimes[session.frames - 1] = GetTime() - session.frameStart;
+
+            // most of the wait sleeps, only the last millisecond is spun for an exact frame length
+            if (!session.fast)
+            {
+                double end = session.frameStart + input.frameTime;
+                if (end - GetTime() > 0.001) WaitTime(end - GetTime() - 0.001);
+                while (GetTime() < end) {}
+            }
+        }
+        session.frameStart = GetTime();
+        session.recordedTime += input.frameTime;
+        session.frames++;
+        return true;
+    }
+
+    input.mouse = GetMousePosition();
+    input.lmbDown = IsMouseButtonDown(MOUSE_LEFT_BUTTON);
+    input.lmbPressed = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+    input.lmbReleased = IsMouseButtonReleased(MOUSE_LEFT_BUTTON);
+    input.keys = 0;
+    for (int i = 0; i < IK_COUNT; i++)
+        if (IsKeyPressed(inputKeys[i])) input.keys |= 1 << i;
+    input.frameTime = GetFrameTime();
+
+    if (session.recording)
+    {
+        unsigned char buttons = input.lmbDown | input.lmbPressed << 1 | input.lmbReleased << 2;
+        fwrite(&input.mouse.x, sizeof(float), 1, session.file);
+        fwrite(&input.mouse.y, sizeof(float), 1, session.file);
+        fwrite(&buttons, 1, 1, session.file);
+        fwrite(&input.keys, 1, 1, session.file);
+        fwrite(&input.frameTime, sizeof(float), 1, session.file);
+    }
+
+    return true;
+}
+
+static int compareFloats(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Closes the log, after a replay the frame time statistics are printed.
+void endSession()
+{
+    if (session.file) fclose(session.file);
+
+    int count = session.frames - 1;
+    if (session.replaying && count > 0)
+    {
+        float *t = session.frameTimes;
+        double sum = 0;
+        for (int i = 0; i < count; i++) sum += t[i];
+        qsort(t, count, sizeof(float), compareFloats);
+
+        printf("Replayed %d frames (recorded %.2f s, replay work %.2f s)\n", session.frames, session.recordedTime, sum);
+        printf(
+            "Frame time ms: avg %.3f  min %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+            sum / count * 1000, t[0] * 1000, t[count / 2] * 1000,
+            t[count * 95 / 100] * 1000, t[count * 99 / 100] * 1000, t[count - 1] * 1000);
+    }
+
+    free(session.frameTimes);
+    session = (Session){0};
+}
+
+// _____________________________________________________________________________
+//
+//  Main
+// _____________________________________________________________________________
+//
+
+int main(int argc, char **argv)
+{
+    bool bench = false;
+    bool fast = false;
+    const char *recordFile = NULL;
+    const char *replayFile = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--bench-render")) bench = true;
+        else if (!strcmp(argv[i], "--fast")) fast = true;
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc) recordFile = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc) replayFile = argv[++i];
+    }
+
+    InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "rlwm");
+    SetTargetFPS(60);
+    SetWindowIcon(LoadImage(TextFormat("%s/logo.png", ASSETS_FOLDER)));
+    SetMouseScale(1 / SCALE, 1 / SCALE);
+
+    // with a whole number scale, every render pixel maps to an exact block of screen pixels,
+    // so the desktop can be drawn straight to the screen with a zoomed camera
+    // while capturing, the render texture is used anyway so the frame can be copied on the GPU
+    bool directRender = DIRECT_RENDER && SCALE == (int)SCALE;
+    Camera2D camera = {.zoom = SCALE};
+
+    RenderTexture rt = {0};
+
+#ifdef DEBUG_OVERDRAW
+    loadOverdraw();
+#endif
+
+    if (FULLSCREEN) ToggleFullscreen();
+
+    font = LoadFontEx(TextFormat("%s/font.ttf", ASSETS_FOLDER), FONT_SIZE, NULL, 95);
+    boldFont = LoadFontEx(TextFormat("%s/font_bold.ttf", ASSETS_FOLDER), FONT_SIZE, NULL, 95);
+    trackTexture(font.texture, "font");
+    trackTexture(boldFont.texture, "bold font");
+
+    Texture bg = trackTexture(LoadTexture(TextFormat("%s/bg.png", ASSETS_FOLDER)), "wallpaper");
+
+    // _________________________________________________________________________
+    //
+    //  Load button images
+    // _________________________________________________________________________
+    //
+
+    Image buttonImage = LoadImage(TextFormat("%s/buttons.png", ASSETS_FOLDER));
+
+    // window control buttons
+    loadChrome(buttonImage);
+
+    for (int i = 0; i < 2; i++)
+    {
+        // small buttons (48 × 16)
+        Image sbutton = ImageCopy(buttonImage);
+        ImageCrop(&sbutton, (Rectangle){i * 48, 12, 48, 16});
+        smallButtons[i] = loadTrackedTexture(sbutton, "buttons");
+        UnloadImage(sbutton);
+
+        // large buttons (96 × 16)
+        Image lbutton = ImageCopy(buttonImage);
+        ImageCrop(&lbutton, (Rectangle){0, 28 + i * 16, 96, 16});
+        largeButtons[i] = loadTrackedTexture(lbutton, "buttons");
+        UnloadImage(lbutton);
+
+        // start buttons (48 × 16)
+        Image stbutton = ImageCopy(buttonImage);
+        ImageCrop(&stbutton, (Rectangle){i * 48, 60, 48, 16});
+        startButtons[i] = loadTrackedTexture(stbutton, "buttons");
+        UnloadImage(stbutton);
+    }
+
+    UnloadImage(buttonImage);
+
+    // _________________________________________________________________________
+    //
+    //  Load icons
+    // _________________________________________________________________________
+    //
+
+    Image iconImage = LoadImage(TextFormat("%s/icons.png", ASSETS_FOLDER));
 
     for (int i = 0; i < IC_COUNT; i++)
     {
         Image icon = ImageCopy(iconImage);
         ImageCrop(&icon, (Rectangle){i * 32, 0, 32, 32});
-        icons[i] = LoadTextureFromImage(icon);
+        icons[i] = loadTrackedTexture(icon, "icons");
         UnloadImage(icon);
     }
 
     UnloadImage(iconImage);
 
+    if (bench)
+    {
+        benchmarkRender(bg);
+        benchmarkChrome();
+        running = false;
+    }
+
+    // the random seed is part of the session log, so replayed windows open at the same places
+    unsigned int seed = time(NULL);
+    if (replayFile && !startReplay(replayFile, &seed))
+    {
+        TraceLog(LOG_ERROR, "SESSION: Failed to read %s", replayFile);
+        running = false;
+    }
+    if (recordFile && !startRecording(recordFile, seed))
+        TraceLog(LOG_WARNING, "SESSION: Failed to create %s", recordFile);
+    // replays are paced by pollInput instead
+    session.fast = fast;
+    if (session.replaying)
+        SetTargetFPS(0);
+    SetRandomSeed(seed);
+
     // _________________________________________________________________________
     //
     //  Main Loop
@@ -489,7 +1958,9 @@ int main()
         // _____________________________________________________________________
         //
 
-        if (IsKeyPressed(KEY_A))
+        if (!pollInput()) break;
+
+        if (keypressed(IK_NEW_WINDOW))
         {
             createWindow((Window){
                 .x = GetRandomValue(0, RENDER_WIDTH - 200),
@@ -505,6 +1976,22 @@ int main()
                 .icon = IC_ERROR});
         }
 
+        if (keypressed(IK_CAPTURE))
+        {
+            if (capture.active)
+            {
+                stopCapture();
+
+                // with direct rendering the desktop render texture was only needed for capturing
+                if (directRender && rt.id)
+                {
+                    unloadTrackedRenderTexture(rt);
+                    rt = (RenderTexture){0};
+                }
+            }
+            else startCapture();
+        }
+
         SetMouseCursor(cursor);
         cursor = MOUSE_CURSOR_DEFAULT;
 
@@ -519,7 +2006,7 @@ int main()
             Window win = windows[i];
             if (!win.active || win.minimized) continue;
 
-            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && mcollide(win.x, win.y, win.width, win.height))
+            if (lmbpressed && mcollide(win.x, win.y, win.width, win.height))
             {
                 focusWindow(i);
                 moving = false;
@@ -543,12 +2030,12 @@ int main()
         }
 
         // if titlebar is clicked on, start moving the window
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && mcollide(win->x, win->y, win->width - 40, 16))
+        if (lmbpressed && mcollide(win->x, win->y, win->width - 40, 16))
         {
             moving = true;
             resizing = false;
-            hook.x = GetMouseX() - win->x;
-            hook.y = GetMouseY() - win->y;
+            hook.x = mousex - win->x;
+            hook.y = mousey - win->y;
         }
 
         // if window is being moved, update its location
@@ -561,15 +2048,15 @@ int main()
 
                 win->width = win->oldPos.width;
                 win->height = win->oldPos.height;
-                win->x = GetMouseX() - win->width / 2;
+                win->x = mousex - win->width / 2;
                 win->y = 0;
 
-                hook.x = GetMouseX() - win->x;
-                hook.y = GetMouseY() - win->y;
+                hook.x = mousex - win->x;
+                hook.y = mousey - win->y;
             }
             cursor = MOUSE_CURSOR_RESIZE_ALL;
-            win->x = GetMouseX() - hook.x;
-            win->y = GetMouseY() - hook.y;
+            win->x = mousex - hook.x;
+            win->y = mousey - hook.y;
         }
 
         // _____________________________________________________________________
@@ -592,14 +2079,31 @@ int main()
 
         if (resizing)
         {
-            win->width = GetMouseX() - win->x;
-            win->height = GetMouseY() - win->y;
+            int oldWidth = win->width;
+            int oldHeight = win->height;
+
+            win->width = mousex - win->x;
+            win->height = mousey - win->y;
 
             // make sure the window is not below its minimum size
             if (win->width < win->minWidth)
                 win->width = win->minWidth;
             if (win->height < win->minHeight)
                 win->height = win->minHeight;
+
+            // the size shown in the title is only formatted when it changes
+            if (win->width != oldWidth || win->height != oldHeight || !sizebuf[0])
+                snprintf(sizebuf, 16, "%d x %d", win->width, win->height);
+
+            // counted in frame time rather than wall clock time, so a replayed session relayouts on the same frames
+            resizeCache.age += input.frameTime;
+            if (RESIZE_RELAYOUT_RATE && (!resizeCache.valid || resizeCache.age >= 1.0f / RESIZE_RELAYOUT_RATE))
+                renderResizeCache(win, WINDOW_LIMIT - 1);
+        }
+        else
+        {
+            resizeCache.valid = false;
+            sizebuf[0] = '\0';
         }
 
         // _____________________________________________________________________
@@ -608,24 +2112,24 @@ int main()
         // _____________________________________________________________________
         //
 
-        BeginTextureMode(rt);
-        ClearBackground(BLACK);
+        bool direct = directRender && !capture.active;
+        if (!direct && !rt.id)
+            rt = loadTrackedRenderTexture(RENDER_WIDTH, RENDER_HEIGHT, "desktop", NULL);
 
-        // draw tiled/scaled background
-        if (TILED_BACKGROUND)
+        if (direct)
         {
-            DrawTextureTiled(
-                bg, (Rectangle){0, 0, bg.width, bg.height},
-                (Rectangle){0, 0, RENDER_WIDTH, RENDER_HEIGHT},
-                (Vector2){0, 0}, 0.0f, 1.0f, WHITE);
-        }
-        else
-        {
-            DrawTexturePro(
-                bg, (Rectangle){0, 0, bg.width, bg.height},
-                (Rectangle){0, 0, RENDER_WIDTH, RENDER_HEIGHT},
-                (Vector2){0, 0}, 0.0f, WHITE);
+            BeginDrawing();
+            BeginMode2D(camera);
         }
+        else BeginTextureMode(rt);
+
+#ifdef DEBUG_OVERDRAW
+        beginOverdraw();
+#endif
+
+        ClearBackground(BLACK);
+        drawWallpaper(bg, RENDER_WIDTH, RENDER_HEIGHT);
+        overdrawRect(LAYER_WALLPAPER, 0, 0, RENDER_WIDTH, RENDER_HEIGHT);
 
         // _____________________________________________________________________
         //
@@ -633,29 +2137,75 @@ int main()
         // _____________________________________________________________________
         //
 
+        // storage of windows closed during the last frame
+        for (int i = 0; i < WINDOW_LIMIT + 1; i++)
+            if (!windows[i].active && windows[i].data) freeWindowData(&windows[i]);
+
+        // the area covered by each window including its shadow, to find windows that don't overlap
+        Rectangle bounds[WINDOW_LIMIT + 1];
+        bool visible[WINDOW_LIMIT + 1];
         for (int i = 0; i < WINDOW_LIMIT + 1; i++)
         {
             Window *win = &windows[i];
-            if (!win->active || win->minimized) continue;
-
-            // draw window shadow
-            DrawRectangle(
-                win->x + SHADOW_OFFSET.x, win->y + SHADOW_OFFSET.y,
-                win->width, win->height, SHADOW_COLOR);
-
-            // draw window background and titlebar
-            DrawRectangle(win->x, win->y, win->width, win->height, WINDOW_BG_COLOR);
-            DrawRectangle(
-                win->x + 1, win->y + 1, win->width - 2, 14,
-                focused(i) ? TITLE_BG_COLOR : TITLE_UNFOCUSED_COLOR);
-
-            // draw title text
-            const char *title = win->title;
-            if (resizing && focused(i))
-                title = TextFormat("%d x %d", win->width, win->height);
-            else if (moving && focused(i))
-                title = TextFormat("%d, %d", win->x, win->y);
-            DrawTextEx(boldFont, title, (Vector2){win->x + 2, win->y + 2}, FONT_SIZE, 0.0f, TITLE_TEXT_COLOR);
+            visible[i] = win->active && !win->minimized;
+            bounds[i] = (Rectangle){
+                win->x, win->y, win->width + SHADOW_OFFSET.x, win->height + SHADOW_OFFSET.y};
+        }
+
+        for (int first = 0; first < WINDOW_LIMIT + 1;)
+        {
+            int last = chromeRunEnd(bounds, visible, first, WINDOW_LIMIT + 1);
+            bool hoverclose[WINDOW_LIMIT + 1] = {0};
+            bool hovermax[WINDOW_LIMIT + 1] = {0};
+            bool hovermin[WINDOW_LIMIT + 1] = {0};
+
+            for (int i = first; i < last; i++)
+            {
+                Window *win = &windows[i];
+                if (!visible[i])
+                {
+                    updateChrome(i, (ChromeKey){0});
+                    continue;
+                }
+
+                hoverclose[i] = mcollide(win->x + win->width - 14, win->y + 2, 12, 12);
+                hovermax[i] = mcollide(win->x + win->width - 27, win->y + 2, 12, 12);
+                hovermin[i] = mcollide(win->x + win->width - 40, win->y + 2, 12, 12);
+
+                updateChrome(i, (ChromeKey){
+                    .visible = true,
+                    .x = win->x,
+                    .y = win->y,
+                    .width = win->width,
+                    .height = win->height,
+                    .focused = focused(i),
+                    .buttons = {
+                        3 + (lmbdown && hoverclose[i]) * 4,
+                        1 + win->maximized + (lmbdown && hovermax[i]) * 4,
+                        0 + (lmbdown && hovermin[i]) * 4}});
+            }
+
+            // draw window shadows, backgrounds and titlebars of the whole run
+            drawChrome(chromeFrames(first), (last - first) * CHROME_FRAME_VERTICES);
+
+            for (int i = first; i < last; i++)
+            {
+                Window *win = &windows[i];
+                if (!visible[i]) continue;
+
+                overdrawRect(LAYER_SHADOW, win->x + SHADOW_OFFSET.x, win->y + SHADOW_OFFSET.y, win->width, win->height);
+                overdrawRect(LAYER_BACKGROUND, win->x, win->y, win->width, win->height);
+                overdrawRect(LAYER_CHROME, win->x + 1, win->y + 1, win->width - 2, 14);
+
+                // draw title text
+                const char *title = win->title;
+                if (resizing && focused(i))
+                    title = sizebuf;
+                else if (moving && focused(i))
+                    title = TextFormat("%d, %d", win->x, win->y);
+                DrawTextEx(boldFont, title, (Vector2){win->x + 2, win->y + 2}, FONT_SIZE, 0.0f, TITLE_TEXT_COLOR);
+                overdrawText(LAYER_CHROME, boldFont, title, win->x + 2, win->y + 2);
+            }
 
             // _________________________________________________________________
             //
@@ -663,58 +2213,74 @@ int main()
             // _________________________________________________________________
             //
 
-            // close button
-            bool hoverclose = mcollide(win->x + win->width - 14, win->y + 2, 12, 12);
-            DrawTexture(
-                winButtons[3 + (lmbdown && hoverclose) * 4],
-                win->x + win->width - 14, win->y + 2, WHITE);
-            if (hoverclose && lmbup) win->active = false;
-
-            // maximize/restore button
-            bool hovermax = mcollide(win->x + win->width - 27, win->y + 2, 12, 12);
-            DrawTexture(
-                winButtons[1 + win->maximized + (lmbdown && hovermax) * 4],
-                win->x + win->width - 27, win->y + 2, WHITE);
-            if (hovermax && lmbup)
+            drawChrome(chromeButtons(first), (last - first) * CHROME_BUTTON_VERTICES);
+
+            for (int i = first; i < last; i++)
             {
-                win->maximized = !win->maximized;
-                if (win->maximized)
-                {
-                    // if window is maximized, save its old coords in oldPos
-                    win->oldPos = (Rectangle){win->x, win->y, win->width, win->height};
-                    win->x = 0;
-                    win->y = 0;
-                    win->width = RENDER_WIDTH;
-                    win->height = RENDER_HEIGHT - 18;
-                }
-                else
-                {
-                    // if window is restored, retrieve its coords from oldPos
-                    win->x = win->oldPos.x;
-                    win->y = win->oldPos.y;
-                    win->width = win->oldPos.width;
-                    win->height = win->oldPos.height;
-                }
+                Window *win = &windows[i];
+                if (!visible[i]) continue;
+
+                overdrawRect(LAYER_CHROME, win->x + win->width - 14, win->y + 2, 12, 12);
+                overdrawRect(LAYER_CHROME, win->x + win->width - 27, win->y + 2, 12, 12);
+                overdrawRect(LAYER_CHROME, win->x + win->width - 40, win->y + 2, 12, 12);
+
+                // the frames of later windows in the run are already drawn, so the content
+                // is clipped to the window to keep it from drawing over them
+                float scale = direct ? SCALE : 1.0f;
+                BeginScissorMode(win->x * scale, win->y * scale, win->width * scale, win->height * scale);
+                if (resizing && focused(i) && resizeCache.valid && resizeCache.target.id) drawResizeCache(win);
+                else runWindow(win, i);
+                EndScissorMode();
             }
 
-            // minimize button
-            bool hovermin = mcollide(win->x + win->width - 40, win->y + 2, 12, 12);
-            DrawTexture(
-                winButtons[0 + (lmbdown && hovermin) * 4],
-                win->x + win->width - 40, win->y + 2, WHITE);
-            if (hovermin && lmbup) win->minimized = true;
+            // button clicks change the geometry of windows, so they are handled after the
+            // whole run is drawn, otherwise a maximized window would cover the run's later frames
+            for (int i = first; i < last; i++)
+            {
+                Window *win = &windows[i];
+                if (!visible[i]) continue;
 
-            // force window to be at least partially on screen
-            if (win->x > RENDER_WIDTH - 5)
-                win->x = RENDER_WIDTH - 5;
-            if (win->y > RENDER_HEIGHT - 20)
-                win->y = RENDER_HEIGHT - 20;
-            if (win->width < 50)
-                win->width = 50;
-            if (win->height < 25)
-                win->width = 24;
+                // close button
+                if (hoverclose[i] && lmbup) win->active = false;
 
-            win->function(win, i);
+                // maximize/restore button
+                if (hovermax[i] && lmbup)
+                {
+                    win->maximized = !win->maximized;
+                    if (win->maximized)
+                    {
+                        // if window is maximized, save its old coords in oldPos
+                        win->oldPos = (Rectangle){win->x, win->y, win->width, win->height};
+                        win->x = 0;
+                        win->y = 0;
+                        win->width = RENDER_WIDTH;
+                        win->height = RENDER_HEIGHT - 18;
+                    }
+                    else
+                    {
+                        // if window is restored, retrieve its coords from oldPos
+                        win->x = win->oldPos.x;
+                        win->y = win->oldPos.y;
+                        win->width = win->oldPos.width;
+                        win->height = win->oldPos.height;
+                    }
+                }
+
+                // minimize button
+                if (hovermin[i] && lmbup) win->minimized = true;
+
+                // force window to be at least partially on screen
+                if (win->x > RENDER_WIDTH - 5)
+                    win->x = RENDER_WIDTH - 5;
+                if (win->y > RENDER_HEIGHT - 20)
+                    win->y = RENDER_HEIGHT - 20;
+                if (win->width < 50)
+                    win->width = 50;
+                if (win->height < 25)
+                    win->width = 24;
+            }
+
+            first = last;
         }
 
 #ifdef DEBUG_MOVERESIZE
@@ -730,6 +2296,8 @@ int main()
         bool starthover = mcollide(1, RENDER_HEIGHT - 17, 48, 16);
         DrawRectangle(0, RENDER_HEIGHT - 18, RENDER_WIDTH, 18, TASKBAR_BG_COLOR);
         DrawTexture(startButtons[starthover && lmbdown], 1, RENDER_HEIGHT - 17, WHITE);
+        overdrawRect(LAYER_TASKBAR, 0, RENDER_HEIGHT - 18, RENDER_WIDTH, 18);
+        overdrawRect(LAYER_TASKBAR, 1, RENDER_HEIGHT - 17, 48, 16);
 
         if (starthover && lmbup)
         {
@@ -753,6 +2321,8 @@ int main()
             DrawTextEx(
                 font, windows[i].title, (Vector2){x + 1, RENDER_HEIGHT - 16},
                 FONT_SIZE, 0.0f, TASKBAR_TEXT_COLOR);
+            overdrawRect(LAYER_TASKBAR, x, RENDER_HEIGHT - 17, 96, 16);
+            overdrawText(LAYER_TASKBAR, font, windows[i].title, x + 1, RENDER_HEIGHT - 16);
 
             if (winbtnhover && lmbup)
             {
@@ -768,10 +2338,17 @@ int main()
         struct tm *tm = localtime(&t);
 
         strftime(timebuf, 16, "%H:%M:%S", tm);
-        DrawTextEx(
-            font, timebuf,
-            (Vector2){RENDER_WIDTH - MeasureTextEx(font, timebuf, FONT_SIZE, 0.0f).x - 3, RENDER_HEIGHT - 15},
-            FONT_SIZE, 0.0f, TASKBAR_TEXT_COLOR);
+        int timex = RENDER_WIDTH - MeasureTextEx(font, timebuf, FONT_SIZE, 0.0f).x - 3;
+        DrawTextEx(font, timebuf, (Vector2){timex, RENDER_HEIGHT - 15}, FONT_SIZE, 0.0f, TASKBAR_TEXT_COLOR);
+        overdrawText(LAYER_TASKBAR, font, timebuf, timex, RENDER_HEIGHT - 15);
+
+#ifdef DEBUG_OVERDRAW
+        endOverdraw();
+#endif
+
+#ifdef DEBUG_TEXMEM
+        drawTextureMemory();
+#endif
 
         // _____________________________________________________________________
         //
@@ -779,15 +2356,41 @@ int main()
         // _____________________________________________________________________
         //
 
-        EndTextureMode();
-        BeginDrawing();
+        if (direct) EndMode2D();
+        else
+        {
+            EndTextureMode();
+            if (capture.active) captureFrame(&rt);
 
-        // render textures have to be vertically flipped when drawing them
-        DrawTexturePro(
-            rt.texture,
-            (Rectangle){0, 0, RENDER_WIDTH, -RENDER_HEIGHT},
-            (Rectangle){0, 0, SCREEN_WIDTH, SCREEN_HEIGHT},
-            (Vector2){0, 0}, 0.0f, WHITE);
+            BeginDrawing();
+            double start = GetTime();
+
+            // render textures have to be vertically flipped when drawing them
+            DrawTexturePro(
+                rt.texture,
+                (Rectangle){0, 0, RENDER_WIDTH, -RENDER_HEIGHT},
+                (Rectangle){0, 0, SCREEN_WIDTH, SCREEN_HEIGHT},
+                (Vector2){0, 0}, 0.0f, WHITE);
+
+            // with direct rendering this pass only exists because of the capture,
+            // so it is this frame's share of the capture overhead
+            if (capture.active && directRender)
+            {
+                rlDrawRenderBatchActive();
+                capture.overhead += (GetTime() - start) * STATS_SMOOTHING;
+            }
+        }
+
+        // capture stats are drawn after the copy so they don't end up in the recording
+        if (capture.active)
+        {
+            DrawText(
+                TextFormat(
+                    "REC %d written, %d skipped, %d dropped, %.2f ms/frame (%.2f ms readback)",
+                    capture.shownWritten, capture.shownSkipped, capture.dropped,
+                    capture.overhead * 1000, capture.readback * 1000),
+                4, SCREEN_HEIGHT - 18 * SCALE - 14, 10, RED);
+        }
 
         EndDrawing();
     }
@@ -798,20 +2401,31 @@ int main()
     // _________________________________________________________________________
     //
 
+    if (capture.active) stopCapture();
+    endSession();
+
+    untrackTexture(font.texture.id);
+    untrackTexture(boldFont.texture.id);
     UnloadFont(font);
     UnloadFont(boldFont);
-    UnloadTexture(bg);
-    UnloadRenderTexture(rt);
+    unloadTrackedTexture(bg);
+    if (rt.id) unloadTrackedRenderTexture(rt);
+    if (resizeCache.target.id) unloadTrackedRenderTexture(resizeCache.target);
 
-    for (int i = 0; i < IC_COUNT; i++) UnloadTexture(icons[i]);
-    for (int i = 0; i < 8; i++) UnloadTexture(winButtons[i]);
+    for (int i = 0; i < WINDOW_LIMIT + 1; i++) freeWindowData(&windows[i]);
+    for (int i = 0; i < IC_COUNT; i++) unloadTrackedTexture(icons[i]);
+    unloadChrome();
+
+#ifdef DEBUG_OVERDRAW
+    unloadOverdraw();
+#endif
     
     // small,large,start
     for (int i = 0; i < 2; i++)
     {
-        UnloadTexture(smallButtons[i]);
-        UnloadTexture(largeButtons[i]);
-        UnloadTexture(startButtons[i]);
+        unloadTrackedTexture(smallButtons[i]);
+        unloadTrackedTexture(largeButtons[i]);
+        unloadTrackedTexture(startButtons[i]);
     }
 
     CloseWindow();